@@ -14,6 +14,7 @@
 #include <inttypes.h>
 #include <exception>
 #include <cstddef>
+#include <vector>
 
 #if defined(ROGUE_PLATFORM_WINDOWS)
 #  include <sys/timeb.h>
@@ -70,12 +71,15 @@ int                Rogue_gc_threshold = ROGUE_GC_THRESHOLD_DEFAULT;
 int                Rogue_gc_count     = 0; // Purely informational
 bool               Rogue_gc_requested = false;
 bool               Rogue_gc_active    = false; // Are we collecting right now?
+RogueGCStats       Rogue_gc_stats;
 RogueLogical       Rogue_configured = 0;
 int                Rogue_argc;
 const char**       Rogue_argv;
 RogueCallbackInfo  Rogue_on_gc_begin;
 RogueCallbackInfo  Rogue_on_gc_trace_finished;
 RogueCallbackInfo  Rogue_on_gc_end;
+RogueCallbackInfo  Rogue_on_threads_terminating;
+bool               Rogue_tasks_can_sleep = false;  // set by a console main() loop
 char               RogueDebugTrace::buffer[512];
 ROGUE_THREAD_LOCAL RogueDebugTrace* Rogue_call_stack = 0;
 
@@ -190,6 +194,7 @@ static void Rogue_thread_unregister ()
 void Rogue_threads_wait_for_all ()
 {
   Rogue_mt_terminating = true;
+  Rogue_on_threads_terminating.call();
   ROGUE_EXIT;
   int wait = 2; // Initial Xms
   int wait_step = 1;
@@ -242,6 +247,56 @@ std::recursive_mutex Rogue_thread_singleton_lock;
 #define ROGUE_SINGLETON_UNLOCK
 #endif
 
+//-----------------------------------------------------------------------------
+//  GC Statistics
+//-----------------------------------------------------------------------------
+RogueReal64 Rogue_gc_time()
+{
+  // Monotonic seconds; only differences are meaningful.
+#if defined(ROGUE_PLATFORM_WINDOWS)
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  if ( !frequency.QuadPart ) QueryPerformanceFrequency( &frequency );
+  QueryPerformanceCounter( &counter );
+  return (RogueReal64) counter.QuadPart / (RogueReal64) frequency.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (RogueReal64) ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#endif
+}
+
+void RogueGCStats_record_pause( int phase, RogueReal64 seconds )
+{
+  RogueGCPauseStats* stats = &Rogue_gc_stats.pauses[phase];
+  ++stats->count;
+  stats->total_seconds += seconds;
+  if (seconds > stats->max_seconds) stats->max_seconds = seconds;
+
+  RogueInt64 microseconds = (RogueInt64)(seconds * 1000000.0);
+  int bucket = 0;
+  while (microseconds > 0 && bucket < ROGUE_GC_PAUSE_BUCKETS-1)
+  {
+    microseconds >>= 1;
+    ++bucket;
+  }
+  ++stats->histogram[bucket];
+}
+
+void RogueGCStats_reset()
+{
+  // Clears the running totals and pause histograms.  Live and since-GC
+  // figures describe the current heap and are kept.
+  Rogue_gc_stats.bytes_allocated = 0;
+  Rogue_gc_stats.objects_allocated = 0;
+  memset( Rogue_gc_stats.pauses, 0, sizeof(Rogue_gc_stats.pauses) );
+  for (int i=0; i<Rogue_type_count; ++i)
+  {
+    Rogue_types[i].bytes_allocated = 0;
+    Rogue_types[i].objects_allocated = 0;
+  }
+}
+
 //-----------------------------------------------------------------------------
 //  GC
 //-----------------------------------------------------------------------------
@@ -392,6 +447,8 @@ inline void Rogue_mtgc_exit()
 
 static void Rogue_mtgc_M1_M2_GC_M3 (int quit)
 {
+  RogueReal64 handshake_start = Rogue_gc_time();
+
   // M1
   ROGUE_MUTEX_LOCK(Rogue_mtgc_w_mutex);
   Rogue_mtgc_w = 1;
@@ -426,6 +483,10 @@ static void Rogue_mtgc_M1_M2_GC_M3 (int quit)
   ROGUE_MUTEX_UNLOCK(Rogue_mtgc_w_mutex);
 #endif
 
+  RogueReal64 handshake_end = Rogue_gc_time();
+  RogueGCStats_record_pause( ROGUE_GC_PHASE_HANDSHAKE, handshake_end - handshake_start );
+  ROGUE_TIMELINE_COMPLETE( "handshake", "gc", handshake_start, handshake_end );
+
   // GC
   // Grab the SOA lock for symmetry.  It should actually never
   // be held by another thread since they're all in GC sleep.
@@ -456,6 +517,7 @@ static void Rogue_mtgc_M1_M2_GC_M3 (int quit)
 static void * Rogue_mtgc_threadproc (void *)
 {
   Rogue_mtgc_is_gc_thread = true;
+  RogueTimeline_set_thread_name( "GC" );
   int quit = 0;
   while (quit == 0)
   {
@@ -572,6 +634,10 @@ std::atomic_int Rogue_allocation_bytes_until_gc(Rogue_gc_threshold);
 #define ROGUE_GC_AT_THRESHOLD (Rogue_allocation_bytes_until_gc.load(std::memory_order_relaxed) <= 0)
 #define ROGUE_GC_RESET_COUNT Rogue_allocation_bytes_until_gc.store(Rogue_gc_threshold, std::memory_order_relaxed);
 
+// Allocation statistics are only read while the world is stopped, so the
+// increments only need to be atomic, not ordered.
+#define ROGUE_GC_STAT_ADD(__var,__x) __atomic_fetch_add(&(__var), (__x), __ATOMIC_RELAXED)
+
 #else // Anything besides auto-mt
 
 #define ROGUE_GC_CHECK /* Does nothing in non-auto-mt modes */
@@ -583,6 +649,12 @@ int Rogue_allocation_bytes_until_gc = Rogue_gc_threshold;
 #define ROGUE_GC_COUNT_BYTES(__x) Rogue_allocation_bytes_until_gc -= (__x);
 #define ROGUE_GC_AT_THRESHOLD (Rogue_allocation_bytes_until_gc <= 0)
 #define ROGUE_GC_RESET_COUNT Rogue_allocation_bytes_until_gc = Rogue_gc_threshold;
+#if ROGUE_GC_MODE_BOEHM && (ROGUE_THREAD_MODE != ROGUE_THREAD_MODE_NONE)
+// Boehm lets threads allocate concurrently.
+#define ROGUE_GC_STAT_ADD(__var,__x) __atomic_fetch_add(&(__var), (__x), __ATOMIC_RELAXED)
+#else
+#define ROGUE_GC_STAT_ADD(__var,__x) ((__var) += (__x))
+#endif
 
 
 #define ROGUE_MTGC_BARRIER
@@ -816,12 +888,27 @@ void RogueString_trace( void* obj )
   ((RogueObject*)obj)->object_size = ~((RogueObject*)obj)->object_size;
 }
 
+#if !ROGUE_GC_MODE_BOEHM
+static FILE* Rogue_heap_dump_fp = 0;
+static void  Rogue_heap_dump_write_ref( void* obj );
+#endif
+
 void RogueArray_trace( void* obj )
 {
   int count;
   RogueObject** src;
   RogueArray* array = (RogueArray*) obj;
 
+#if !ROGUE_GC_MODE_BOEHM
+  if (Rogue_heap_dump_fp)
+  {
+    // Arrays are usually traced with a direct call rather than through
+    // type->trace_fn; record the reference instead of following it.
+    Rogue_heap_dump_write_ref( array );
+    return;
+  }
+#endif
+
   if ( !array || array->object_size < 0 ) return;
   array->object_size = ~array->object_size;
 
@@ -1088,7 +1175,7 @@ RogueInt32 RogueString_set_cursor( RogueString* THIS, int index )
 
 RogueString* RogueString_validate( RogueString* THIS )
 {
-  // Trims any invalid UTF-8, counts the number of characters, and sets the hash code
+  // Trims any invalid UTF-8, counts the number of characters, and clears the hash code
   THIS->is_ascii = 1;  // assumption
 
   int character_count = 0;
@@ -1144,16 +1231,164 @@ RogueString* RogueString_validate( RogueString* THIS )
 
   THIS->byte_count = i;
   THIS->character_count = character_count;
+  THIS->hash_code = 0;  // computed on first use by RogueString_hash_code()
+  return THIS;
+}
+
+RogueInt32 RogueString_hash_code( RogueString* THIS )
+{
+  // Two threads may both compute the hash of a shared string; they store the
+  // same value.
+  RogueInt32 hash = THIS->hash_code;
+  if (hash) return hash;
+  return THIS->hash_code = Rogue_hash_utf8( THIS->utf8, THIS->byte_count );
+}
+
+//-----------------------------------------------------------------------------
+//  String Hashing
+//-----------------------------------------------------------------------------
+// wyhash (final version 4, public domain) by Wang Yi, keyed with a per-process
+// random seed so that the bin a key lands in can't be predicted from outside.
+// Set the environment variable ROGUE_HASH_SEED to a number to make hash codes,
+// and so the order of anything that depends on them, reproducible.
+RogueUInt64 Rogue_hash_seed = 0;
+
+static const RogueUInt64 Rogue_hash_secret[4] =
+{
+  0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static inline void Rogue_hash_multiply( RogueUInt64* a, RogueUInt64* b )
+{
+  // 64x64->128-bit multiply: *a = low half, *b = high half
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = *a;
+  r *= *b;
+  *a = (RogueUInt64) r;
+  *b = (RogueUInt64) (r >> 64);
+#else
+  RogueUInt64 ha = *a >> 32, hb = *b >> 32, la = (RogueUInt32)*a, lb = (RogueUInt32)*b;
+  RogueUInt64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  RogueUInt64 t = rl + (rm0 << 32), c = (t < rl);
+  RogueUInt64 lo = t + (rm1 << 32);
+  c += (lo < t);
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline RogueUInt64 Rogue_hash_mix( RogueUInt64 a, RogueUInt64 b )
+{
+  Rogue_hash_multiply( &a, &b );
+  return a ^ b;
+}
+
+static inline RogueUInt64 Rogue_hash_read8( const unsigned char* p )
+{
+  RogueUInt64 v;
+  memcpy( &v, p, 8 );
+  return v;
+}
+
+static inline RogueUInt64 Rogue_hash_read4( const unsigned char* p )
+{
+  RogueUInt32 v;
+  memcpy( &v, p, 4 );
+  return v;
+}
+
+RogueUInt64 Rogue_hash_bytes( const void* data, int count, RogueUInt64 seed )
+{
+  const unsigned char* p = (const unsigned char*) data;
+  const RogueUInt64*   secret = Rogue_hash_secret;
+  RogueUInt64 len = (RogueUInt64) count;
+  RogueUInt64 a, b;
+
+  seed ^= Rogue_hash_mix( seed ^ secret[0], secret[1] );
+  if (len <= 16)
+  {
+    if (len >= 4)
+    {
+      a = (Rogue_hash_read4(p) << 32) | Rogue_hash_read4( p + ((len>>3)<<2) );
+      b = (Rogue_hash_read4(p+len-4) << 32) | Rogue_hash_read4( p + len - 4 - ((len>>3)<<2) );
+    }
+    else if (len > 0)
+    {
+      a = (((RogueUInt64)p[0]) << 16) | (((RogueUInt64)p[len>>1]) << 8) | p[len-1];
+      b = 0;
+    }
+    else
+    {
+      a = b = 0;
+    }
+  }
+  else
+  {
+    RogueUInt64 i = len;
+    if (i >= 48)
+    {
+      // Three independent lanes keep the multipliers busy
+      RogueUInt64 see1 = seed, see2 = seed;
+      do
+      {
+        seed = Rogue_hash_mix( Rogue_hash_read8(p)    ^ secret[1], Rogue_hash_read8(p+8)  ^ seed );
+        see1 = Rogue_hash_mix( Rogue_hash_read8(p+16) ^ secret[2], Rogue_hash_read8(p+24) ^ see1 );
+        see2 = Rogue_hash_mix( Rogue_hash_read8(p+32) ^ secret[3], Rogue_hash_read8(p+40) ^ see2 );
+        p += 48;
+        i -= 48;
+      }
+      while (i >= 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16)
+    {
+      seed = Rogue_hash_mix( Rogue_hash_read8(p) ^ secret[1], Rogue_hash_read8(p+8) ^ seed );
+      i -= 16;
+      p += 16;
+    }
+    a = Rogue_hash_read8( p + i - 16 );
+    b = Rogue_hash_read8( p + i - 8 );
+  }
+
+  a ^= secret[1];
+  b ^= seed;
+  Rogue_hash_multiply( &a, &b );
+  return Rogue_hash_mix( a ^ secret[0] ^ len, b ^ secret[1] );
+}
+
+RogueInt32 Rogue_hash_utf8( const void* utf8, int count )
+{
+  // Folds the 64-bit hash to the Int32 used by hash_code(). 0 is reserved to
+  // mean "not computed yet".
+  RogueUInt64 hash = Rogue_hash_bytes( utf8, count, Rogue_hash_seed );
+  RogueInt32 result = (RogueInt32)(RogueUInt32)(hash ^ (hash >> 32));
+  return result ? result : 1;
+}
 
-  int code = 0;
-  int len = THIS->byte_count;
-  char* src = THIS->utf8 - 1;
-  while (--len >= 0)
+void Rogue_configure_hash_seed()
+{
+  const char* setting = getenv( "ROGUE_HASH_SEED" );
+  if (setting && *setting)
   {
-    code = ((code<<3) - code) + *(++src);
+    Rogue_hash_seed = (RogueUInt64) strtoull( setting, 0, 0 );
+    return;
   }
-  THIS->hash_code = code;
-  return THIS;
+
+  RogueUInt64 seed = 0;
+#if !defined(ROGUE_PLATFORM_WINDOWS)
+  FILE* urandom = fopen( "/dev/urandom", "rb" );
+  if (urandom)
+  {
+    if (fread( &seed, sizeof(seed), 1, urandom ) != 1) seed = 0;
+    fclose( urandom );
+  }
+#endif
+  if ( !seed )
+  {
+    seed = Rogue_hash_mix( (RogueUInt64) time(0) ^ Rogue_hash_secret[2],
+        ((RogueUInt64)(intptr_t)&seed) ^ ((RogueUInt64)clock() << 32) ^ Rogue_hash_secret[3] );
+  }
+  Rogue_hash_seed = seed;
 }
 
 //-----------------------------------------------------------------------------
@@ -1488,6 +1723,12 @@ RogueObject* RogueAllocator_allocate_object( RogueAllocator* THIS, RogueType* of
 
   obj->type = of_type;
 
+  ROGUE_GC_STAT_ADD( of_type->bytes_allocated, size );
+  ROGUE_GC_STAT_ADD( of_type->objects_allocated, 1 );
+  ROGUE_GC_STAT_ADD( Rogue_gc_stats.bytes_since_gc, size );
+  ROGUE_GC_STAT_ADD( Rogue_gc_stats.objects_since_gc, 1 );
+  if ((RogueProfiler_allocation_countdown -= size) < 0) RogueProfiler_sample_allocation( obj, size );
+
   return obj;
 }
 #else
@@ -1506,6 +1747,12 @@ RogueObject* RogueAllocator_allocate_object( RogueAllocator* THIS, RogueType* of
   obj->type = of_type;
   obj->object_size = size;
 
+  ROGUE_GC_STAT_ADD( of_type->bytes_allocated, size );
+  ROGUE_GC_STAT_ADD( of_type->objects_allocated, 1 );
+  ROGUE_GC_STAT_ADD( Rogue_gc_stats.bytes_since_gc, size );
+  ROGUE_GC_STAT_ADD( Rogue_gc_stats.objects_since_gc, 1 );
+  if ((RogueProfiler_allocation_countdown -= size) < 0) RogueProfiler_sample_allocation( obj, size );
+
   ROGUE_MTGC_BARRIER; // Probably not necessary
 
   if (of_type->on_cleanup_fn)
@@ -1577,9 +1824,13 @@ void RogueAllocator_free_all( )
   }
 }
 
+// Accumulated across all allocators during a single collection.
+static RogueReal64 Rogue_gc_phase_seconds[ROGUE_GC_PHASE_COUNT];
+
 void RogueAllocator_collect_garbage( RogueAllocator* THIS )
 {
   // Global program objects have already been traced through.
+  RogueReal64 phase_start = Rogue_gc_time();
 
   // Trace through all as-yet unreferenced objects that are manually retained.
   RogueObject* cur = THIS->objects;
@@ -1617,6 +1868,8 @@ void RogueAllocator_collect_garbage( RogueAllocator* THIS )
     if (cur->object_size < 0)
     {
       // Referenced.
+      Rogue_gc_stats.live_bytes += ~cur->object_size;
+      ++Rogue_gc_stats.live_objects;
       cur->next_object = survivors;
       survivors = cur;
     }
@@ -1636,6 +1889,11 @@ void RogueAllocator_collect_garbage( RogueAllocator* THIS )
   // due to be deleted.
   Rogue_on_gc_trace_finished.call();
 
+  RogueReal64 now = Rogue_gc_time();
+  Rogue_gc_phase_seconds[ROGUE_GC_PHASE_MARK] += now - phase_start;
+  ROGUE_TIMELINE_COMPLETE( "mark", "gc", phase_start, now );
+  phase_start = now;
+
   // Now that on_gc_trace_finished() has been called we can reset the "collected" status flag
   // on all objects requiring cleanup.
   cur = THIS->objects_requiring_cleanup;
@@ -1656,6 +1914,8 @@ void RogueAllocator_collect_garbage( RogueAllocator* THIS )
     if (cur->object_size < 0)
     {
       cur->object_size = ~cur->object_size;
+      Rogue_gc_stats.live_bytes += cur->object_size;
+      ++Rogue_gc_stats.live_objects;
       cur->next_object = survivors;
       survivors = cur;
     }
@@ -1671,6 +1931,10 @@ void RogueAllocator_collect_garbage( RogueAllocator* THIS )
 
   THIS->objects = survivors;
 
+  now = Rogue_gc_time();
+  Rogue_gc_phase_seconds[ROGUE_GC_PHASE_SWEEP] += now - phase_start;
+  ROGUE_TIMELINE_COMPLETE( "sweep", "gc", phase_start, now );
+  phase_start = now;
 
   // Call on_cleanup() on unreferenced objects requiring cleanup
   // and move them to the general objects list so they'll be deleted
@@ -1685,40 +1949,1087 @@ void RogueAllocator_collect_garbage( RogueAllocator* THIS )
     cur->type->on_cleanup_fn( cur );
 
     cur->object_size = ~cur->object_size;
+    Rogue_gc_stats.live_bytes += cur->object_size;
+    ++Rogue_gc_stats.live_objects;
     cur->next_object = THIS->objects;
     THIS->objects = cur;
 
     cur = next_object;
   }
 
-  if (Rogue_gc_logging)
+  now = Rogue_gc_time();
+  Rogue_gc_phase_seconds[ROGUE_GC_PHASE_CLEANUP] += now - phase_start;
+  ROGUE_TIMELINE_COMPLETE( "cleanup", "gc", phase_start, now );
+}
+
+//-----------------------------------------------------------------------------
+//  Heap Dump
+//-----------------------------------------------------------------------------
+// Snapshot format written by Rogue_dump_heap() (integers are little-endian):
+//
+//   "ROGUEHEAP" version:Int32
+//   type_count:Int32 { name_byte_count:Int32 name:UTF8 }[type_count]
+//   'R' { root_id:Int64 } 0:Int64 { A-record }
+//   { 'O' id:Int64 type_index:Int32 size:Int32 { ref_id:Int64 } 0:Int64 { A-record } }
+//   'E'
+//
+//   A-record: 'A' array_id:Int64 { ref_id:Int64 } 0:Int64
+//
+// Object ids are addresses and are only meaningful within a snapshot.
+// References are recorded by temporarily replacing every type's trace_fn
+// with Rogue_heap_dump_write_ref() and then calling each object's original
+// trace function.
+//
+// Arrays of compounds aren't traced through a trace_fn: their owners call
+// the array's generated trace function directly, and every array's type is
+// RogueTypeArray.  Those trace functions call
+// Rogue_heap_dump_intercept_array(), which records the owner->array
+// reference and queues the array.  Once the current record is finished,
+// each queued array is walked with its own trace function and its elements'
+// references are written as an 'A' record that adds to the array's 'O'
+// record.  A queued array keeps its mark bit until the dump ends so that
+// it's walked only once.  The queue is a fixed-size stack; if it fills, an
+// array's element references are written as part of its owner's record.
+//
+// Apart from a table of the saved trace functions the dump streams through
+// fixed buffers, and it runs after the collection's pause times and
+// timeline event are recorded.
+#if !ROGUE_GC_MODE_BOEHM
+#define ROGUE_HEAP_DUMP_VERSION 2
+#define ROGUE_HEAP_DUMP_MAX_PENDING 4096
+
+bool Rogue_heap_dump_active = false;
+
+static char*         Rogue_heap_dump_filepath = 0;
+static bool          Rogue_heap_dump_succeeded = false;
+static unsigned char Rogue_heap_dump_buffer[65536];
+static int           Rogue_heap_dump_position = 0;
+
+static void Rogue_heap_dump_flush()
+{
+  if (Rogue_heap_dump_position)
   {
-    int byte_count = 0;
-    int object_count = 0;
+    fwrite( Rogue_heap_dump_buffer, 1, Rogue_heap_dump_position, Rogue_heap_dump_fp );
+    Rogue_heap_dump_position = 0;
+  }
+}
 
-    for (int i=0; i<Rogue_allocator_count; ++i)
+static void Rogue_heap_dump_write_bytes( const void* data, int count )
+{
+  if (Rogue_heap_dump_position + count > (int)sizeof(Rogue_heap_dump_buffer))
+  {
+    Rogue_heap_dump_flush();
+    if (count > (int)sizeof(Rogue_heap_dump_buffer))
     {
-      RogueAllocator* allocator = &Rogue_allocators[i];
+      fwrite( data, 1, count, Rogue_heap_dump_fp );
+      return;
+    }
+  }
+  memcpy( Rogue_heap_dump_buffer + Rogue_heap_dump_position, data, count );
+  Rogue_heap_dump_position += count;
+}
+
+static void Rogue_heap_dump_write_byte( int value )
+{
+  if (Rogue_heap_dump_position == (int)sizeof(Rogue_heap_dump_buffer)) Rogue_heap_dump_flush();
+  Rogue_heap_dump_buffer[ Rogue_heap_dump_position++ ] = (unsigned char) value;
+}
+
+static void Rogue_heap_dump_write_int32( RogueInt32 value )
+{
+  unsigned char bytes[4];
+  for (int i=0; i<4; ++i) bytes[i] = (unsigned char)(((RogueUInt32)value) >> (i*8));
+  Rogue_heap_dump_write_bytes( bytes, 4 );
+}
+
+static void Rogue_heap_dump_write_int64( RogueInt64 value )
+{
+  unsigned char bytes[8];
+  for (int i=0; i<8; ++i) bytes[i] = (unsigned char)(((RogueUInt64)value) >> (i*8));
+  Rogue_heap_dump_write_bytes( bytes, 8 );
+}
+
+static void Rogue_heap_dump_write_ref( void* obj )
+{
+  if (obj) Rogue_heap_dump_write_int64( (RogueInt64)(intptr_t)obj );
+}
+
+static RogueArray*  Rogue_heap_dump_expanding_array = 0;
+static RogueArray*  Rogue_heap_dump_pending_arrays[ ROGUE_HEAP_DUMP_MAX_PENDING ];
+static RogueTraceFn Rogue_heap_dump_pending_trace_fns[ ROGUE_HEAP_DUMP_MAX_PENDING ];
+static int          Rogue_heap_dump_pending_count = 0;
 
-      RogueObject* cur = allocator->objects;
-      while (cur)
+bool Rogue_heap_dump_intercept_array( RogueArray* array, RogueTraceFn trace_fn )
+{
+  // Returns false when the caller should go on to trace the array's
+  // elements, which is only while the array is being expanded.
+  if (array == Rogue_heap_dump_expanding_array)
+  {
+    if (array->object_size < 0) array->object_size = ~array->object_size;
+    return false;
+  }
+
+  Rogue_heap_dump_write_ref( array );
+  if (array->object_size < 0) return true;  // already queued or walked
+
+  if (Rogue_heap_dump_pending_count == ROGUE_HEAP_DUMP_MAX_PENDING) return false;
+  array->object_size = ~array->object_size;
+  Rogue_heap_dump_pending_arrays[ Rogue_heap_dump_pending_count ] = array;
+  Rogue_heap_dump_pending_trace_fns[ Rogue_heap_dump_pending_count ] = trace_fn;
+  ++Rogue_heap_dump_pending_count;
+  return true;
+}
+
+static void Rogue_heap_dump_expand_arrays()
+{
+  // Writes an 'A' record for each queued array of compounds.  Arrays nested
+  // in the elements are queued in turn.
+  while (Rogue_heap_dump_pending_count)
+  {
+    --Rogue_heap_dump_pending_count;
+    RogueArray*  array = Rogue_heap_dump_pending_arrays[ Rogue_heap_dump_pending_count ];
+    RogueTraceFn fn = Rogue_heap_dump_pending_trace_fns[ Rogue_heap_dump_pending_count ];
+
+    Rogue_heap_dump_write_byte( 'A' );
+    Rogue_heap_dump_write_int64( (RogueInt64)(intptr_t)array );
+    Rogue_heap_dump_expanding_array = array;
+    fn( array );
+    Rogue_heap_dump_expanding_array = 0;
+    Rogue_heap_dump_write_int64( 0 );
+  }
+}
+
+static void Rogue_heap_dump_unmark_all( bool keep_arrays )
+{
+  // Trace functions reached by direct call still set the mark bit.  Arrays
+  // keep theirs while the dump is running so that none is walked twice.
+  for (int i=0; i<Rogue_allocator_count; ++i)
+  {
+    RogueAllocator* allocator = &Rogue_allocators[i];
+    for (RogueObject* cur=allocator->objects; cur; cur=cur->next_object)
+    {
+      if (cur->object_size < 0 && !(keep_arrays && cur->type == RogueTypeArray))
+      {
+        cur->object_size = ~cur->object_size;
+      }
+    }
+    for (RogueObject* cur=allocator->objects_requiring_cleanup; cur; cur=cur->next_object)
+    {
+      if (cur->object_size < 0 && !(keep_arrays && cur->type == RogueTypeArray))
       {
-        ++object_count;
-        byte_count += cur->object_size;
-        cur = cur->next_object;
+        cur->object_size = ~cur->object_size;
       }
+    }
+  }
+}
+
+static void Rogue_heap_dump_write_object( RogueObject* obj, RogueTraceFn* trace_fns )
+{
+  Rogue_heap_dump_write_byte( 'O' );
+  Rogue_heap_dump_write_int64( (RogueInt64)(intptr_t)obj );
+  Rogue_heap_dump_write_int32( obj->type->index );
+
+  int size = (obj->object_size < 0) ? ~obj->object_size : obj->object_size;
+  Rogue_heap_dump_write_int32( size );
+
+  if (obj->type == RogueTypeArray)
+  {
+    RogueArray* array = (RogueArray*) obj;
+    if (array->is_reference_array)
+    {
+      for (int i=0; i<array->count; ++i) Rogue_heap_dump_write_ref( array->as_objects[i] );
+    }
+  }
+  else
+  {
+    obj->object_size = size;
+    RogueTraceFn fn = trace_fns[ obj->type->index ];
+    if (fn) fn( obj );
+    obj->object_size = size;
+  }
+
+  Rogue_heap_dump_write_int64( 0 );
+  Rogue_heap_dump_expand_arrays();
+}
+
+bool Rogue_dump_heap( const char* filepath )
+{
+  // Must be called while no other thread is running Rogue code and no
+  // collection is in progress - see Rogue_request_heap_dump().
+  Rogue_heap_dump_fp = fopen( filepath, "wb" );
+  if ( !Rogue_heap_dump_fp ) return false;
+  Rogue_heap_dump_position = 0;
+
+  Rogue_heap_dump_write_bytes( "ROGUEHEAP", 9 );
+  Rogue_heap_dump_write_int32( ROGUE_HEAP_DUMP_VERSION );
+
+  Rogue_heap_dump_write_int32( Rogue_type_count );
+  for (int i=0; i<Rogue_type_count; ++i)
+  {
+    RogueString* name = Rogue_literal_strings[ Rogue_types[i].name_index ];
+    int byte_count = name ? name->byte_count : 0;
+    Rogue_heap_dump_write_int32( byte_count );
+    if (byte_count) Rogue_heap_dump_write_bytes( name->utf8, byte_count );
+  }
+
+  Rogue_heap_dump_pending_count = 0;
+  Rogue_heap_dump_active = true;
+
+  RogueTraceFn* trace_fns = new RogueTraceFn[ Rogue_type_count ];
+  for (int i=0; i<Rogue_type_count; ++i)
+  {
+    trace_fns[i] = Rogue_types[i].trace_fn;
+    Rogue_types[i].trace_fn = Rogue_heap_dump_write_ref;
+  }
+
+  // Roots: globals and singletons, then manually retained objects.
+  Rogue_heap_dump_write_byte( 'R' );
+  Rogue_trace();
+  for (int i=0; i<Rogue_allocator_count; ++i)
+  {
+    RogueAllocator* allocator = &Rogue_allocators[i];
+    for (RogueObject* cur=allocator->objects; cur; cur=cur->next_object)
+    {
+      if (cur->reference_count > 0) Rogue_heap_dump_write_ref( cur );
+    }
+    for (RogueObject* cur=allocator->objects_requiring_cleanup; cur; cur=cur->next_object)
+    {
+      if (cur->reference_count > 0) Rogue_heap_dump_write_ref( cur );
+    }
+  }
+  Rogue_heap_dump_write_int64( 0 );
+  Rogue_heap_dump_expand_arrays();
+  Rogue_heap_dump_unmark_all( true );
+
+  for (int i=0; i<Rogue_allocator_count; ++i)
+  {
+    RogueAllocator* allocator = &Rogue_allocators[i];
+    for (RogueObject* cur=allocator->objects; cur; cur=cur->next_object)
+    {
+      Rogue_heap_dump_write_object( cur, trace_fns );
+    }
+    for (RogueObject* cur=allocator->objects_requiring_cleanup; cur; cur=cur->next_object)
+    {
+      Rogue_heap_dump_write_object( cur, trace_fns );
+    }
+  }
+  Rogue_heap_dump_write_byte( 'E' );
+
+  for (int i=0; i<Rogue_type_count; ++i) Rogue_types[i].trace_fn = trace_fns[i];
+  delete [] trace_fns;
+  Rogue_heap_dump_unmark_all( false );
+
+  Rogue_heap_dump_active = false;
+
+  Rogue_heap_dump_flush();
+  bool success = !ferror( Rogue_heap_dump_fp );
+  fclose( Rogue_heap_dump_fp );
+  Rogue_heap_dump_fp = 0;
+  return success;
+}
+
+void Rogue_request_heap_dump( const char* filepath )
+{
+  // The snapshot is written by the next collection, after the sweep, when
+  // every other thread is stopped and only live objects remain.
+  if (Rogue_heap_dump_filepath) free( Rogue_heap_dump_filepath );
+  Rogue_heap_dump_filepath = strdup( filepath );
+  Rogue_heap_dump_succeeded = false;
+}
+
+bool Rogue_heap_dump_result()
+{
+  return Rogue_heap_dump_succeeded;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+//  Profiler
+//-----------------------------------------------------------------------------
+// SIGPROF-driven sampler.  Each sample is written to a preallocated buffer
+// as a header slot (kind << 16 | depth) followed by 'depth' frames, leaf
+// first.  In --debug builds the frames are RogueDebugTrace method signatures.
+// Otherwise they are code addresses that are mapped back to Rogue methods
+// through Rogue_method_address_table; only the leaf address is recorded
+// unless ROGUE_PROFILER_FRAME_POINTERS is defined and the program was
+// compiled with -fno-omit-frame-pointer.
+#define ROGUE_PROFILER_MAX_DEPTH   128
+#define ROGUE_PROFILER_NAMES       1
+#define ROGUE_PROFILER_ADDRESSES   2
+
+#if !defined(ROGUE_PLATFORM_WINDOWS)
+#if defined(__APPLE__)
+#  include <sys/ucontext.h>
+#else
+#  include <ucontext.h>
+#endif
+#include <sched.h>
+#endif
+
+#include <map>
+#include <string>
+#include <vector>
+
+static void**       RogueProfiler_buffer = 0;
+static int          RogueProfiler_capacity = 0;
+static volatile int RogueProfiler_position = 0;
+static volatile int RogueProfiler_samples = 0;
+static volatile int RogueProfiler_dropped = 0;
+static volatile int RogueProfiler_in_handler = 0;
+static volatile bool RogueProfiler_running = false;
+static RogueMethodAddress* RogueProfiler_methods = 0;
+static int          RogueProfiler_method_count = 0;
+
+#if !defined(ROGUE_PLATFORM_WINDOWS)
+static void* RogueProfiler_context_pc( void* context, void** fp )
+{
+  ucontext_t* uc = (ucontext_t*) context;
+#if defined(__APPLE__) && defined(__x86_64__)
+  *fp = (void*) uc->uc_mcontext->__ss.__rbp;
+  return (void*) uc->uc_mcontext->__ss.__rip;
+#elif defined(__APPLE__) && defined(__aarch64__)
+  *fp = (void*) uc->uc_mcontext->__ss.__fp;
+  return (void*) uc->uc_mcontext->__ss.__pc;
+#elif defined(__linux__) && defined(__x86_64__)
+  *fp = (void*) uc->uc_mcontext.gregs[REG_RBP];
+  return (void*) uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__linux__) && defined(__aarch64__)
+  *fp = (void*) uc->uc_mcontext.regs[29];
+  return (void*) uc->uc_mcontext.pc;
+#else
+  *fp = 0;
+  return 0;
+#endif
+}
+
+static void RogueProfiler_on_signal( int sig, siginfo_t* info, void* context )
+{
+  // Count this handler in before looking at 'running' so that stop() can't
+  // see no handlers, return and free the buffer while this one goes ahead.
+  __sync_fetch_and_add( &RogueProfiler_in_handler, 1 );
+  if ( !RogueProfiler_running )
+  {
+    __sync_fetch_and_sub( &RogueProfiler_in_handler, 1 );
+    return;
+  }
+  int saved_errno = errno;
+
+  void* frames[ ROGUE_PROFILER_MAX_DEPTH ];
+  int depth = 0;
+  int kind;
+
+  RogueDebugTrace* trace = Rogue_call_stack;
+  if (trace)
+  {
+    kind = ROGUE_PROFILER_NAMES;
+    while (trace && depth < ROGUE_PROFILER_MAX_DEPTH)
+    {
+      frames[depth++] = (void*) trace->method_signature;
+      trace = trace->previous_trace;
+    }
+  }
+  else
+  {
+    kind = ROGUE_PROFILER_ADDRESSES;
+    void* fp;
+    void* pc = RogueProfiler_context_pc( context, &fp );
+    if (pc) frames[depth++] = pc;
+#if defined(ROGUE_PROFILER_FRAME_POINTERS)
+    while (fp && depth < ROGUE_PROFILER_MAX_DEPTH)
+    {
+      void** frame = (void**) fp;
+      void*  next = frame[0];
+      void*  return_address = frame[1];
+      if ( !return_address ) break;
+      frames[depth++] = return_address;
+      // Frames must move toward the base of the stack in modest steps.
+      if ((char*)next <= (char*)fp || (char*)next - (char*)fp > (1 << 20)) break;
+      fp = next;
+    }
+#endif
+  }
+
+  if (depth)
+  {
+    int start = __sync_fetch_and_add( &RogueProfiler_position, depth+1 );
+    if (start + depth + 1 <= RogueProfiler_capacity)
+    {
+      memcpy( RogueProfiler_buffer + start + 1, frames, depth * sizeof(void*) );
+      RogueProfiler_buffer[start] = (void*)(intptr_t)((kind << 16) | depth);
+      __sync_fetch_and_add( &RogueProfiler_samples, 1 );
+    }
+    else
+    {
+      __sync_fetch_and_add( &RogueProfiler_dropped, 1 );
+    }
+  }
+
+  errno = saved_errno;
+  __sync_fetch_and_sub( &RogueProfiler_in_handler, 1 );
+}
+#endif
+
+static int RogueProfiler_compare_methods( const void* a, const void* b )
+{
+  char* address_a = (char*)((const RogueMethodAddress*)a)->address;
+  char* address_b = (char*)((const RogueMethodAddress*)b)->address;
+  if (address_a < address_b) return -1;
+  if (address_a > address_b) return 1;
+  return 0;
+}
+
+static const char* RogueProfiler_method_name( void* address )
+{
+  // Returns the method whose code most closely precedes 'address'.
+  char* pc = (char*) address;
+  int lo = 0;
+  int hi = RogueProfiler_method_count - 1;
+  int best = -1;
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) >> 1;
+    if ((char*)RogueProfiler_methods[mid].address <= pc) { best = mid; lo = mid + 1; }
+    else                                                { hi = mid - 1; }
+  }
+  if (best < 0) return "[native]";
+  if (best == RogueProfiler_method_count-1 && pc - (char*)RogueProfiler_methods[best].address > 65536)
+  {
+    return "[native]";
+  }
+  return RogueProfiler_methods[best].name;
+}
+
+static void RogueProfiler_load_methods()
+{
+#if ROGUE_METHOD_ADDRESS_TABLE
+  if ( !RogueProfiler_methods )
+  {
+    RogueProfiler_method_count = Rogue_method_address_count;
+    RogueProfiler_methods = new RogueMethodAddress[ RogueProfiler_method_count ];
+    memcpy( RogueProfiler_methods, Rogue_method_address_table, RogueProfiler_method_count * sizeof(RogueMethodAddress) );
+    qsort( RogueProfiler_methods, RogueProfiler_method_count, sizeof(RogueMethodAddress), RogueProfiler_compare_methods );
+  }
+#endif
+}
+
+static const char* RogueProfiler_frame_name( int kind, void* frame, bool is_pc )
+{
+  if (kind == ROGUE_PROFILER_NAMES) return (const char*) frame;
+  if (is_pc)                        return RogueProfiler_method_name( frame );
+  return RogueProfiler_method_name( (char*)frame - 1 );  // return address
+}
+
+static void RogueProfiler_append_frame( std::string& stack, const char* name )
+{
+  if (stack.size()) stack += ';';
+  for (const char* cur=name; *cur; ++cur)
+  {
+    char ch = *cur;
+    stack += (ch == ' ' || ch == ';') ? '_' : ch;
+  }
+}
+
+bool RogueProfiler_start( int hz, int max_frames )
+{
+#if defined(ROGUE_PLATFORM_WINDOWS)
+  return false;
+#else
+  if (RogueProfiler_running || hz <= 0 || max_frames <= 0) return false;
+
+  if (RogueProfiler_capacity != max_frames)
+  {
+    delete [] RogueProfiler_buffer;
+    RogueProfiler_buffer = new void*[ max_frames ];
+    RogueProfiler_capacity = max_frames;
+  }
+  memset( RogueProfiler_buffer, 0, max_frames * sizeof(void*) );
+  RogueProfiler_position = 0;
+  RogueProfiler_samples = 0;
+  RogueProfiler_dropped = 0;
+
+  RogueProfiler_load_methods();
+
+  struct sigaction sa;
+  memset( &sa, 0, sizeof(sa) );
+  sigemptyset( &sa.sa_mask );
+  sa.sa_sigaction = RogueProfiler_on_signal;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  if (sigaction( SIGPROF, &sa, NULL ) != 0) return false;
+
+  RogueProfiler_running = true;
+
+  struct itimerval timer;
+  int interval = 1000000 / hz;
+  if (interval <= 0) interval = 1;
+  timer.it_interval.tv_sec = interval / 1000000;
+  timer.it_interval.tv_usec = interval % 1000000;
+  timer.it_value = timer.it_interval;
+  if (setitimer( ITIMER_PROF, &timer, NULL ) != 0)
+  {
+    RogueProfiler_running = false;
+    return false;
+  }
+  return true;
+#endif
+}
+
+void RogueProfiler_stop()
+{
+#if !defined(ROGUE_PLATFORM_WINDOWS)
+  if ( !RogueProfiler_running ) return;
+
+  struct itimerval timer;
+  memset( &timer, 0, sizeof(timer) );
+  setitimer( ITIMER_PROF, &timer, NULL );
+  RogueProfiler_running = false;
+  __sync_synchronize();
+
+  // Let any handler that's already running on another thread finish.
+  while (RogueProfiler_in_handler) sched_yield();
+  signal( SIGPROF, SIG_IGN );
+#endif
+}
+
+bool RogueProfiler_is_running()
+{
+  return RogueProfiler_running;
+}
+
+int RogueProfiler_sample_count()
+{
+  return RogueProfiler_samples;
+}
+
+int RogueProfiler_dropped_count()
+{
+  return RogueProfiler_dropped;
+}
+
+RogueString* RogueProfiler_folded_stacks()
+{
+  // "root;caller;...;leaf count" lines as consumed by flamegraph.pl.
+  std::map<std::string,int> counts;
+  std::string stack;
+
+  int limit = RogueProfiler_position;
+  if (limit > RogueProfiler_capacity) limit = RogueProfiler_capacity;
+
+  int i = 0;
+  while (i < limit)
+  {
+    int header = (int)(intptr_t) RogueProfiler_buffer[i];
+    if ( !header ) break;
+    int kind  = header >> 16;
+    int depth = header & 0xFFFF;
+    void** frames = RogueProfiler_buffer + i + 1;
+
+    stack.clear();
+    for (int f=depth-1; f>=0; --f)
+    {
+      RogueProfiler_append_frame( stack, RogueProfiler_frame_name( kind, frames[f], f == 0 ) );
+    }
+    ++counts[ stack ];
+
+    i += depth + 1;
+  }
+
+  std::string result;
+  for (std::map<std::string,int>::iterator entry=counts.begin(); entry!=counts.end(); ++entry)
+  {
+    char count_buffer[32];
+    snprintf( count_buffer, sizeof(count_buffer), " %d\n", entry->second );
+    result += entry->first;
+    result += count_buffer;
+  }
+  return RogueString_create_from_utf8( result.c_str(), (int)result.size() );
+}
+
+//-----------------------------------------------------------------------------
+//  Allocation Profiler
+//-----------------------------------------------------------------------------
+// Allocations are sampled as a Poisson process over allocated bytes: each
+// thread counts down a random, exponentially distributed number of bytes
+// (mean RogueProfiler_allocation_interval) and the allocation that crosses
+// zero is recorded.  An allocation of 'size' bytes is therefore sampled with
+// probability 1 - e^(-size/interval) and each sample is weighted by the
+// inverse of that probability, which gives unbiased byte estimates for
+// objects both smaller and larger than the interval.
+//
+// While sampling is off the countdown is simply refilled with a large value,
+// so the cost in RogueAllocator_allocate_object is one thread-local subtract
+// and a branch.
+//
+// Each sampled object is remembered until the next collection finishes
+// marking, at which point it is recorded as having survived or not.
+#define ROGUE_PROFILER_IDLE_COUNTDOWN          (1024*1024)
+#define ROGUE_PROFILER_MAX_ALLOCATION_SAMPLES  (1024*1024)
+
+struct RogueAllocationSample
+{
+  RogueObject* object;     // cleared by the next collection
+  RogueReal64  weight;     // estimated bytes this sample represents
+  int          type_index;
+  int          size;
+  int          kind;
+  int          first_frame;
+  int          depth;
+  int          survival;   // -1:unknown, 0:collected, 1:survived
+};
+
+ROGUE_THREAD_LOCAL RogueInt64 RogueProfiler_allocation_countdown = ROGUE_PROFILER_IDLE_COUNTDOWN;
+static ROGUE_THREAD_LOCAL int         RogueProfiler_allocation_thread_epoch = 0;
+static ROGUE_THREAD_LOCAL RogueUInt64 RogueProfiler_random_state = 0;
+
+static volatile RogueInt64 RogueProfiler_allocation_interval = 0;  // 0 = off
+static volatile int  RogueProfiler_allocation_epoch = 0;
+static volatile int  RogueProfiler_allocation_lock = 0;
+static volatile int  RogueProfiler_allocation_dropped = 0;
+static int           RogueProfiler_allocation_pending = 0;  // first sample not yet seen by the GC
+static bool          RogueProfiler_allocation_gc_hooked = false;
+static RogueReal64   RogueProfiler_allocation_start_time = 0;
+static RogueReal64   RogueProfiler_allocation_stop_time = 0;
+static std::vector<RogueAllocationSample> RogueProfiler_allocation_samples;
+static std::vector<void*>                 RogueProfiler_allocation_frames;
+
+#define ROGUE_PROFILER_ALLOCATION_LOCK   while (__sync_lock_test_and_set( &RogueProfiler_allocation_lock, 1 )) {}
+#define ROGUE_PROFILER_ALLOCATION_UNLOCK __sync_lock_release( &RogueProfiler_allocation_lock );
+
+static RogueInt64 RogueProfiler_next_allocation_countdown( RogueInt64 interval )
+{
+  // xorshift64, seeded per thread.
+  RogueUInt64 x = RogueProfiler_random_state;
+  if ( !x ) x = ((RogueUInt64)(intptr_t)&RogueProfiler_random_state ^ (RogueUInt64)(Rogue_gc_time() * 1e9)) | 1;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  RogueProfiler_random_state = x;
+
+  RogueReal64 u = (RogueReal64)((x >> 11) + 1) * (1.0 / 9007199254740992.0);  // (0,1]
+  RogueReal64 n = -log( u ) * (RogueReal64)interval;
+  if (n < 1) n = 1;
+  if (n > (RogueReal64)interval * 32) n = (RogueReal64)interval * 32;
+  return (RogueInt64) n;
+}
+
+static void RogueProfiler_on_allocation_gc()
+{
+  // Called once marking is complete: a negative object_size means the
+  // sampled object is still reachable.
+#if !ROGUE_GC_MODE_BOEHM
+  ROGUE_PROFILER_ALLOCATION_LOCK
+  int count = (int) RogueProfiler_allocation_samples.size();
+  for (int i=RogueProfiler_allocation_pending; i<count; ++i)
+  {
+    RogueAllocationSample& sample = RogueProfiler_allocation_samples[i];
+    if (sample.object)
+    {
+      sample.survival = (sample.object->object_size < 0) ? 1 : 0;
+      sample.object = 0;
+    }
+  }
+  RogueProfiler_allocation_pending = count;
+  ROGUE_PROFILER_ALLOCATION_UNLOCK
+#endif
+}
+
+void RogueProfiler_sample_allocation( RogueObject* obj, int size )
+{
+  RogueInt64 interval = RogueProfiler_allocation_interval;
+  if ( !interval )
+  {
+    RogueProfiler_allocation_countdown = ROGUE_PROFILER_IDLE_COUNTDOWN;
+    return;
+  }
+
+  RogueProfiler_allocation_countdown = RogueProfiler_next_allocation_countdown( interval );
+  if (RogueProfiler_allocation_thread_epoch != RogueProfiler_allocation_epoch)
+  {
+    // This thread's countdown predates the current session and wasn't drawn
+    // from the sampling distribution; start counting now.
+    RogueProfiler_allocation_thread_epoch = RogueProfiler_allocation_epoch;
+    return;
+  }
+
+  void* frames[ ROGUE_PROFILER_MAX_DEPTH ];
+  int depth = 0;
+  int kind = ROGUE_PROFILER_ADDRESSES;
+
+  RogueDebugTrace* trace = Rogue_call_stack;
+  if (trace)
+  {
+    kind = ROGUE_PROFILER_NAMES;
+    while (trace && depth < ROGUE_PROFILER_MAX_DEPTH)
+    {
+      frames[depth++] = (void*) trace->method_signature;
+      trace = trace->previous_trace;
+    }
+  }
+#if defined(ROGUE_PROFILER_FRAME_POINTERS)
+  else
+  {
+    void* fp = __builtin_frame_address( 0 );
+    while (fp && depth < ROGUE_PROFILER_MAX_DEPTH)
+    {
+      void** frame = (void**) fp;
+      void*  next = frame[0];
+      void*  return_address = frame[1];
+      if ( !return_address ) break;
+      frames[depth++] = return_address;
+      if ((char*)next <= (char*)fp || (char*)next - (char*)fp > (1 << 20)) break;
+      fp = next;
+    }
+  }
+#endif
+
+  RogueAllocationSample sample;
+#if ROGUE_GC_MODE_BOEHM
+  sample.object = 0;
+#else
+  sample.object = obj;
+#endif
+  sample.weight = (RogueReal64)size / (1.0 - exp( -(RogueReal64)size / (RogueReal64)interval ));
+  sample.type_index = obj->type->index;
+  sample.size = size;
+  sample.kind = kind;
+  sample.depth = depth;
+  sample.survival = -1;
+
+  ROGUE_PROFILER_ALLOCATION_LOCK
+  if (RogueProfiler_allocation_samples.size() < ROGUE_PROFILER_MAX_ALLOCATION_SAMPLES)
+  {
+    sample.first_frame = (int) RogueProfiler_allocation_frames.size();
+    RogueProfiler_allocation_frames.insert( RogueProfiler_allocation_frames.end(), frames, frames+depth );
+    RogueProfiler_allocation_samples.push_back( sample );
+  }
+  else
+  {
+    ++RogueProfiler_allocation_dropped;
+  }
+  ROGUE_PROFILER_ALLOCATION_UNLOCK
+}
+
+bool RogueProfiler_start_allocations( RogueInt64 bytes_per_sample )
+{
+  if (RogueProfiler_allocation_interval || bytes_per_sample <= 0) return false;
+
+  RogueProfiler_load_methods();
+
+  ROGUE_PROFILER_ALLOCATION_LOCK
+  RogueProfiler_allocation_samples.clear();
+  RogueProfiler_allocation_frames.clear();
+  RogueProfiler_allocation_pending = 0;
+  RogueProfiler_allocation_dropped = 0;
+  if ( !RogueProfiler_allocation_gc_hooked )
+  {
+    Rogue_on_gc_trace_finished.add( RogueProfiler_on_allocation_gc );
+    RogueProfiler_allocation_gc_hooked = true;
+  }
+  ROGUE_PROFILER_ALLOCATION_UNLOCK
+
+  RogueProfiler_allocation_start_time = Rogue_gc_time();
+  RogueProfiler_allocation_stop_time = 0;
+  __sync_fetch_and_add( &RogueProfiler_allocation_epoch, 1 );
+  RogueProfiler_allocation_interval = bytes_per_sample;
+
+  // Other threads join the session within ROGUE_PROFILER_IDLE_COUNTDOWN bytes.
+  RogueProfiler_allocation_thread_epoch = RogueProfiler_allocation_epoch;
+  RogueProfiler_allocation_countdown = RogueProfiler_next_allocation_countdown( bytes_per_sample );
+  return true;
+}
+
+void RogueProfiler_stop_allocations()
+{
+  if ( !RogueProfiler_allocation_interval ) return;
+  RogueProfiler_allocation_interval = 0;
+  RogueProfiler_allocation_stop_time = Rogue_gc_time();
+}
+
+bool RogueProfiler_is_sampling_allocations()
+{
+  return RogueProfiler_allocation_interval != 0;
+}
+
+RogueReal64 RogueProfiler_allocation_seconds()
+{
+  if ( !RogueProfiler_allocation_start_time ) return 0;
+  RogueReal64 stop_time = RogueProfiler_allocation_stop_time;
+  if ( !stop_time ) stop_time = Rogue_gc_time();
+  return stop_time - RogueProfiler_allocation_start_time;
+}
+
+int RogueProfiler_allocation_sample_count()
+{
+  ROGUE_PROFILER_ALLOCATION_LOCK
+  int count = (int) RogueProfiler_allocation_samples.size();
+  ROGUE_PROFILER_ALLOCATION_UNLOCK
+  return count;
+}
+
+static RogueAllocationSample RogueProfiler_allocation_sample( int index )
+{
+  // Other threads may still be adding samples, which can reallocate the
+  // vector, so samples are copied out under the lock.
+  ROGUE_PROFILER_ALLOCATION_LOCK
+  RogueAllocationSample sample = RogueProfiler_allocation_samples[index];
+  ROGUE_PROFILER_ALLOCATION_UNLOCK
+  return sample;
+}
+
+int RogueProfiler_allocation_dropped_count()
+{
+  return RogueProfiler_allocation_dropped;
+}
+
+int RogueProfiler_allocation_sample_type( int index )
+{
+  return RogueProfiler_allocation_sample( index ).type_index;
+}
+
+RogueReal64 RogueProfiler_allocation_sample_bytes( int index )
+{
+  return RogueProfiler_allocation_sample( index ).weight;
+}
+
+int RogueProfiler_allocation_sample_survival( int index )
+{
+  return RogueProfiler_allocation_sample( index ).survival;
+}
+
+RogueString* RogueProfiler_allocation_sample_site( int index )
+{
+  // The sample's call chain in folded-stack order (root first).  In release
+  // builds the innermost frames belong to the allocator itself and are
+  // dropped.
+  ROGUE_PROFILER_ALLOCATION_LOCK
+  RogueAllocationSample sample = RogueProfiler_allocation_samples[index];
+  std::vector<void*> frames( RogueProfiler_allocation_frames.begin() + sample.first_frame,
+      RogueProfiler_allocation_frames.begin() + sample.first_frame + sample.depth );
+  ROGUE_PROFILER_ALLOCATION_UNLOCK
+
+  int leaf = 0;
+  if (sample.kind == ROGUE_PROFILER_ADDRESSES)
+  {
+    while (leaf < sample.depth && !strcmp(RogueProfiler_frame_name(sample.kind,frames[leaf],false),"[native]")) ++leaf;
+  }
+
+  std::string site;
+  for (int f=sample.depth-1; f>=leaf; --f)
+  {
+    RogueProfiler_append_frame( site, RogueProfiler_frame_name( sample.kind, frames[f], false ) );
+  }
+  if ( !site.size() ) site = "[unknown]";
+  return RogueString_create_from_utf8( site.c_str(), (int)site.size() );
+}
 
-      cur = allocator->objects_requiring_cleanup;
-      while (cur)
+//-----------------------------------------------------------------------------
+//  Timeline
+//-----------------------------------------------------------------------------
+// Each thread records events into its own power-of-two ring buffer that only
+// it writes to; when a buffer fills, the oldest events are overwritten.
+// Buffers are linked into a global list the first time a thread records an
+// event and are kept for the life of the program so that RogueTimeline_save()
+// can read them after their threads have exited.  A buffer left over from a
+// previous session is reset by its owner on the next event it records.
+// Resetting, resizing and publishing a buffer happen under
+// RogueTimeline_buffers_lock, which RogueTimeline_save() holds while it
+// reads the buffers, so a save never reads an array that is being replaced.
+//
+// Names and categories must be static strings; RogueTimeline_intern()
+// provides one for a Rogue String.
+struct RogueTimelineEvent
+{
+  RogueReal64 timestamp;
+  RogueReal64 duration;
+  const char* name;
+  const char* category;
+  char        phase;
+};
+
+struct RogueTimelineBuffer
+{
+  RogueTimelineEvent*  events;
+  int                  capacity;  // power of two
+  volatile RogueInt64  position;  // total events written this session
+  int                  session;
+  int                  thread_id;
+  const char*          thread_name;
+  RogueTimelineBuffer* next;
+};
+
+volatile bool RogueTimeline_enabled = false;
+
+static RogueTimelineBuffer* volatile RogueTimeline_buffers = 0;
+static ROGUE_THREAD_LOCAL RogueTimelineBuffer* RogueTimeline_thread_buffer = 0;
+static ROGUE_THREAD_LOCAL const char*          RogueTimeline_thread_name = 0;
+static volatile int  RogueTimeline_session = 0;
+static volatile int  RogueTimeline_thread_count = 0;
+static int           RogueTimeline_capacity = 0;
+static RogueReal64   RogueTimeline_start_time = 0;
+static volatile int  RogueTimeline_names_lock = 0;
+static volatile int  RogueTimeline_buffers_lock = 0;
+
+static void RogueTimeline_lock_buffers()
+{
+  while (__sync_lock_test_and_set( &RogueTimeline_buffers_lock, 1 )) std::this_thread::yield();
+}
+
+static void RogueTimeline_unlock_buffers()
+{
+  __sync_lock_release( &RogueTimeline_buffers_lock );
+}
+
+void RogueTimeline_record( char phase, const char* name, const char* category,
+                           RogueReal64 timestamp, RogueReal64 duration )
+{
+  RogueTimelineBuffer* buffer = RogueTimeline_thread_buffer;
+  int session = RogueTimeline_session;
+  if ( !buffer || buffer->session != session )
+  {
+    RogueTimeline_lock_buffers();
+    if ( !buffer )
+    {
+      buffer = new RogueTimelineBuffer();
+      buffer->thread_id = __sync_add_and_fetch( &RogueTimeline_thread_count, 1 );
+      buffer->thread_name = RogueTimeline_thread_name;
+      RogueTimeline_thread_buffer = buffer;
+    }
+    if (buffer->capacity != RogueTimeline_capacity)
+    {
+      delete [] buffer->events;
+      buffer->capacity = RogueTimeline_capacity;
+      buffer->events = new RogueTimelineEvent[ buffer->capacity ];
+    }
+    buffer->position = 0;
+    if ( !buffer->session )
+    {
+      // First use: publish the buffer.
+      RogueTimelineBuffer* head;
+      do
       {
-        ++object_count;
-        byte_count += cur->object_size;
-        cur = cur->next_object;
+        head = RogueTimeline_buffers;
+        buffer->next = head;
       }
+      while ( !__sync_bool_compare_and_swap( &RogueTimeline_buffers, head, buffer ) );
+    }
+    buffer->session = session;
+    RogueTimeline_unlock_buffers();
+  }
+
+  RogueInt64 position = buffer->position;
+  RogueTimelineEvent* event = &buffer->events[ position & (buffer->capacity - 1) ];
+  event->timestamp = timestamp;
+  event->duration = duration;
+  event->name = name;
+  event->category = category;
+  event->phase = phase;
+  __sync_synchronize();
+  buffer->position = position + 1;
+}
+
+const char* RogueTimeline_intern( RogueString* name )
+{
+  static std::map<std::string,int> names;
+  if ( !name ) return "null";
+  while (__sync_lock_test_and_set( &RogueTimeline_names_lock, 1 )) {}
+  const char* result = names.insert( std::make_pair(std::string(name->utf8,name->byte_count),0) ).first->first.c_str();
+  __sync_lock_release( &RogueTimeline_names_lock );
+  return result;
+}
+
+const char* RogueTimeline_type_name( RogueObject* obj )
+{
+  return Rogue_literal_strings[ obj->type->name_index ]->utf8;
+}
+
+void RogueTimeline_set_thread_name( const char* name )
+{
+  RogueTimeline_thread_name = name;
+  if (RogueTimeline_thread_buffer) RogueTimeline_thread_buffer->thread_name = name;
+}
+
+bool RogueTimeline_start( int events_per_thread )
+{
+  if (RogueTimeline_enabled || events_per_thread <= 0) return false;
+
+  int capacity = 1;
+  while (capacity < events_per_thread && capacity < (1<<30)) capacity <<= 1;
+  RogueTimeline_capacity = capacity;
+
+  RogueTimeline_start_time = Rogue_gc_time();
+  __sync_add_and_fetch( &RogueTimeline_session, 1 );
+  RogueTimeline_enabled = true;
+  return true;
+}
+
+void RogueTimeline_stop()
+{
+  RogueTimeline_enabled = false;
+}
+
+static void RogueTimeline_write_string( FILE* fp, const char* st )
+{
+  fputc( '"', fp );
+  for (const char* cur=st; *cur; ++cur)
+  {
+    unsigned char ch = (unsigned char) *cur;
+    if (ch == '"' || ch == '\\') { fputc( '\\', fp ); fputc( ch, fp ); }
+    else if (ch < 32)             fprintf( fp, "\\u%04x", ch );
+    else                          fputc( ch, fp );
+  }
+  fputc( '"', fp );
+}
+
+bool RogueTimeline_save( const char* filepath )
+{
+  // Writes every event from the current session in the JSON Object Format
+  // accepted by chrome://tracing and Perfetto.  Timestamps are microseconds
+  // since RogueTimeline_start().
+  FILE* fp = fopen( filepath, "wb" );
+  if ( !fp ) return false;
+
+  fprintf( fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+  bool first = true;
+  RogueTimeline_lock_buffers();
+  for (RogueTimelineBuffer* buffer=RogueTimeline_buffers; buffer; buffer=buffer->next)
+  {
+    if (buffer->session != RogueTimeline_session) continue;
+
+    if (first) first = false;
+    else       fputc( ',', fp );
+    fprintf( fp, "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", buffer->thread_id );
+    if (buffer->thread_name)
+    {
+      RogueTimeline_write_string( fp, buffer->thread_name );
+    }
+    else
+    {
+      fprintf( fp, "\"Thread %d\"", buffer->thread_id );
     }
+    fprintf( fp, "}}" );
 
-    ROGUE_LOG( "Post-GC: %d objects, %d bytes used.\n", object_count, byte_count );
+    __sync_synchronize();
+    RogueInt64 end = buffer->position;
+    RogueInt64 start = end - buffer->capacity;
+    if (start < 0) start = 0;
+    for (RogueInt64 i=start; i<end; ++i)
+    {
+      RogueTimelineEvent* event = &buffer->events[ i & (buffer->capacity - 1) ];
+      fprintf( fp, ",\n{\"name\":" );
+      RogueTimeline_write_string( fp, event->name );
+      fprintf( fp, ",\"cat\":" );
+      RogueTimeline_write_string( fp, event->category );
+      fprintf( fp, ",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+          event->phase, buffer->thread_id, (event->timestamp - RogueTimeline_start_time) * 1000000.0 );
+      if (event->phase == 'X') fprintf( fp, ",\"dur\":%.3f", event->duration * 1000000.0 );
+      fputc( '}', fp );
+    }
   }
+  RogueTimeline_unlock_buffers();
+  fprintf( fp, "\n]}\n" );
+
+  bool success = !ferror( fp );
+  if (fclose( fp ) != 0) success = false;
+  return success;
 }
 
 void Rogue_print_stack_trace ( bool leading_newline )
@@ -1781,10 +3092,14 @@ void Rogue_update_weak_references_during_gc()
 
 void Rogue_configure_types()
 {
+  Rogue_configure_hash_seed();
+
 #if ROGUE_THREAD_MODE == ROGUE_THREAD_MODE_PTHREADS
 _rogue_init_mutex(&Rogue_thread_singleton_lock);
 #endif
 
+  RogueTimeline_set_thread_name( "main" );
+
   int i;
   const int* next_type_info = Rogue_type_info_table;
 
@@ -1896,14 +3211,26 @@ static GC_ToggleRefStatus Rogue_Boehm_ToggleRefStatus( void * o )
   return GC_TOGGLE_REF_DROP;
 }
 
+static RogueReal64 Rogue_Boehm_gc_start_time = 0;
+
 static void Rogue_Boehm_on_collection_event( GC_EventType event )
 {
   if (event == GC_EVENT_START)
   {
+    ++Rogue_gc_count;
+    Rogue_Boehm_gc_start_time = Rogue_gc_time();
     Rogue_on_gc_begin.call();
   }
   else if (event == GC_EVENT_END)
   {
+    // Boehm doesn't report individual phases or object counts.
+    Rogue_gc_stats.bytes_allocated += Rogue_gc_stats.bytes_since_gc;
+    Rogue_gc_stats.objects_allocated += Rogue_gc_stats.objects_since_gc;
+    Rogue_gc_stats.bytes_since_gc = 0;
+    Rogue_gc_stats.objects_since_gc = 0;
+    Rogue_gc_stats.live_bytes = (RogueInt64)(GC_get_heap_size() - GC_get_free_bytes());
+    Rogue_gc_stats.live_objects = -1;
+    RogueGCStats_record_pause( ROGUE_GC_PHASE_TOTAL, Rogue_gc_time() - Rogue_Boehm_gc_start_time );
     Rogue_on_gc_end.call();
   }
 }
@@ -1916,6 +3243,7 @@ void Rogue_configure_gc()
   GC_set_on_collection_event(Rogue_Boehm_on_collection_event);
   //GC_set_all_interior_pointers(0);
   GC_INIT();
+  Rogue_gc_stats.live_objects = -1;
 }
 #elif ROGUE_GC_MODE_AUTO_MT
 // Rogue_configure_gc already defined above.
@@ -1963,9 +3291,25 @@ static inline void Rogue_collect_garbage_real()
 //ROGUE_LOG( "GC %d\n", Rogue_allocation_bytes_until_gc );
   ROGUE_GC_RESET_COUNT;
 
+  RogueReal64 gc_start = Rogue_gc_time();
+
+  // Objects allocated from here on (by on_cleanup() or the GC callbacks)
+  // belong to the next cycle.
+  Rogue_gc_stats.bytes_allocated += Rogue_gc_stats.bytes_since_gc;
+  Rogue_gc_stats.objects_allocated += Rogue_gc_stats.objects_since_gc;
+  Rogue_gc_stats.bytes_since_gc = 0;
+  Rogue_gc_stats.objects_since_gc = 0;
+  Rogue_gc_stats.live_bytes = 0;
+  Rogue_gc_stats.live_objects = 0;
+
   Rogue_on_gc_begin.call();
 
+  RogueReal64 trace_start = Rogue_gc_time();
   Rogue_trace();
+  RogueReal64 trace_end = Rogue_gc_time();
+  memset( Rogue_gc_phase_seconds, 0, sizeof(Rogue_gc_phase_seconds) );
+  Rogue_gc_phase_seconds[ROGUE_GC_PHASE_MARK] = trace_end - trace_start;
+  ROGUE_TIMELINE_COMPLETE( "mark roots", "gc", trace_start, trace_end );
 
   for (int i=0; i<Rogue_allocator_count; ++i)
   {
@@ -1973,6 +3317,33 @@ static inline void Rogue_collect_garbage_real()
   }
 
   Rogue_on_gc_end.call();
+
+  RogueGCStats_record_pause( ROGUE_GC_PHASE_MARK,    Rogue_gc_phase_seconds[ROGUE_GC_PHASE_MARK] );
+  RogueGCStats_record_pause( ROGUE_GC_PHASE_SWEEP,   Rogue_gc_phase_seconds[ROGUE_GC_PHASE_SWEEP] );
+  RogueGCStats_record_pause( ROGUE_GC_PHASE_CLEANUP, Rogue_gc_phase_seconds[ROGUE_GC_PHASE_CLEANUP] );
+  RogueReal64 gc_end = Rogue_gc_time();
+  RogueReal64 gc_time = gc_end - gc_start;
+  RogueGCStats_record_pause( ROGUE_GC_PHASE_TOTAL, gc_time );
+  ROGUE_TIMELINE_COMPLETE( "GC", "gc", gc_start, gc_end );
+
+#if !ROGUE_GC_MODE_BOEHM
+  // Written while the world is still stopped but outside the pause that
+  // GCStats and the timeline's GC event report.
+  if (Rogue_heap_dump_filepath)
+  {
+    Rogue_heap_dump_succeeded = Rogue_dump_heap( Rogue_heap_dump_filepath );
+    free( Rogue_heap_dump_filepath );
+    Rogue_heap_dump_filepath = 0;
+    ROGUE_TIMELINE_COMPLETE( "heap dump", "gc", gc_end, Rogue_gc_time() );
+  }
+#endif
+
+  if (Rogue_gc_logging)
+  {
+    ROGUE_LOG( "Post-GC: %lld objects, %lld bytes used (%.3f ms).\n",
+        (long long) Rogue_gc_stats.live_objects, (long long) Rogue_gc_stats.live_bytes, gc_time*1000.0 );
+  }
+
   Rogue_gc_active = false;
 }
 
@@ -2009,6 +3380,7 @@ void Rogue_quit()
 
   Rogue_gc_logging = false;
   Rogue_gc_count = 0;
+  memset( &Rogue_gc_stats, 0, sizeof(Rogue_gc_stats) );
   Rogue_gc_requested = 0;
   Rogue_gc_active = 0;
   Rogue_call_stack = 0;
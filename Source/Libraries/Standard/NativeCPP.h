@@ -118,7 +118,7 @@ template<typename RT> RT Rogue_mtgc_reenter (RT expr);
 #define ROGUE_EXIT
 
 #define ROGUE_BLOCKING_CALL(__x) __x
-#define ROGUE_BLOCKING_VOID_CALL(__x)
+#define ROGUE_BLOCKING_VOID_CALL(__x) __x
 
 #endif
 
@@ -586,6 +586,9 @@ struct RogueType
   RogueCleanUpFn    on_cleanup_fn;
   RogueToStringFn   to_string_fn;
 
+  RogueInt64        bytes_allocated;    // running totals for GC statistics
+  RogueInt64        objects_allocated;
+
 #if ROGUE_GC_MODE_BOEHM_TYPED
   int          gc_alloc_type;
   GC_descr     gc_type_descr;
@@ -654,7 +657,7 @@ struct RogueString : RogueObject
   RogueInt32 is_ascii;
   RogueInt32 cursor_offset;
   RogueInt32 cursor_index;
-  RogueInt32 hash_code;
+  RogueInt32 hash_code;        // 0 until first requested
 #if ROGUE_GC_MODE_BOEHM_TYPED
   char       *utf8;
 #else
@@ -672,6 +675,12 @@ void         RogueString_print_utf8( char* utf8, int count );
 RogueCharacter RogueString_character_at( RogueString* THIS, int index );
 RogueInt32     RogueString_set_cursor( RogueString* THIS, int index );
 RogueString*   RogueString_validate( RogueString* THIS );
+RogueInt32     RogueString_hash_code( RogueString* THIS );
+
+extern RogueUInt64 Rogue_hash_seed;
+RogueUInt64 Rogue_hash_bytes( const void* data, int count, RogueUInt64 seed );
+RogueInt32  Rogue_hash_utf8( const void* utf8, int count );
+void        Rogue_configure_hash_seed();
 
 
 //-----------------------------------------------------------------------------
@@ -824,6 +833,55 @@ extern bool               Rogue_gc_requested;
 extern RogueCallbackInfo  Rogue_on_gc_begin;
 extern RogueCallbackInfo  Rogue_on_gc_trace_finished;
 extern RogueCallbackInfo  Rogue_on_gc_end;
+extern RogueCallbackInfo  Rogue_on_threads_terminating;
+extern bool               Rogue_tasks_can_sleep;
+
+//-----------------------------------------------------------------------------
+//  GC Statistics
+//-----------------------------------------------------------------------------
+#define ROGUE_GC_PHASE_HANDSHAKE 0  // auto-mt: waiting for other threads to stop
+#define ROGUE_GC_PHASE_MARK      1
+#define ROGUE_GC_PHASE_SWEEP     2
+#define ROGUE_GC_PHASE_CLEANUP   3  // on_cleanup() calls
+#define ROGUE_GC_PHASE_TOTAL     4
+#define ROGUE_GC_PHASE_COUNT     5
+
+// Bucket i counts pauses shorter than 2^i microseconds; the last bucket also
+// holds everything longer.
+#define ROGUE_GC_PAUSE_BUCKETS   24
+
+struct RogueGCPauseStats
+{
+  RogueInt64  count;
+  RogueReal64 total_seconds;
+  RogueReal64 max_seconds;
+  RogueInt64  histogram[ROGUE_GC_PAUSE_BUCKETS];
+};
+
+struct RogueGCStats
+{
+  RogueInt64 bytes_allocated;     // before the most recent GC
+  RogueInt64 objects_allocated;
+  RogueInt64 bytes_since_gc;      // allocated since the most recent GC began
+  RogueInt64 objects_since_gc;
+  RogueInt64 live_bytes;          // surviving the most recent GC
+  RogueInt64 live_objects;        // -1 under Boehm, which doesn't count them
+  RogueGCPauseStats pauses[ROGUE_GC_PHASE_COUNT];
+};
+
+extern RogueGCStats Rogue_gc_stats;
+
+RogueReal64 Rogue_gc_time();
+void        RogueGCStats_record_pause( int phase, RogueReal64 seconds );
+void        RogueGCStats_reset();
+
+#if !ROGUE_GC_MODE_BOEHM
+extern bool Rogue_heap_dump_active;
+bool Rogue_heap_dump_intercept_array( RogueArray* array, RogueTraceFn trace_fn );
+bool Rogue_dump_heap( const char* filepath );
+void Rogue_request_heap_dump( const char* filepath );
+bool Rogue_heap_dump_result();
+#endif
 
 struct RogueWeakReference;
 extern RogueWeakReference* Rogue_weak_references;
@@ -860,6 +918,68 @@ struct RogueDebugTrace
 void Rogue_print_stack_trace ( bool leading_newline=false);
 
 
+//-----------------------------------------------------------------------------
+//  Profiler
+//-----------------------------------------------------------------------------
+struct RogueMethodAddress
+{
+  void*       address;
+  const char* name;
+};
+
+#if ROGUE_METHOD_ADDRESS_TABLE
+extern const RogueMethodAddress Rogue_method_address_table[];
+extern const int                Rogue_method_address_count;
+#endif
+
+bool         RogueProfiler_start( int hz, int max_frames );
+void         RogueProfiler_stop();
+bool         RogueProfiler_is_running();
+int          RogueProfiler_sample_count();
+int          RogueProfiler_dropped_count();
+RogueString* RogueProfiler_folded_stacks();
+
+extern ROGUE_THREAD_LOCAL RogueInt64 RogueProfiler_allocation_countdown;
+
+void         RogueProfiler_sample_allocation( RogueObject* obj, int size );
+bool         RogueProfiler_start_allocations( RogueInt64 bytes_per_sample );
+void         RogueProfiler_stop_allocations();
+bool         RogueProfiler_is_sampling_allocations();
+RogueReal64  RogueProfiler_allocation_seconds();
+int          RogueProfiler_allocation_sample_count();
+int          RogueProfiler_allocation_dropped_count();
+int          RogueProfiler_allocation_sample_type( int index );
+RogueReal64  RogueProfiler_allocation_sample_bytes( int index );
+int          RogueProfiler_allocation_sample_survival( int index );
+RogueString* RogueProfiler_allocation_sample_site( int index );
+
+
+//-----------------------------------------------------------------------------
+//  Timeline
+//-----------------------------------------------------------------------------
+// Records begin/end and complete events for Chrome's trace_event format.
+// While the timeline is off each hook costs a single branch.
+#define ROGUE_TIMELINE_BEGIN(name,category) \
+  do { if (RogueTimeline_enabled) RogueTimeline_record( 'B', name, category, Rogue_gc_time(), 0 ); } while (false)
+
+#define ROGUE_TIMELINE_END(name,category) \
+  do { if (RogueTimeline_enabled) RogueTimeline_record( 'E', name, category, Rogue_gc_time(), 0 ); } while (false)
+
+#define ROGUE_TIMELINE_COMPLETE(name,category,start_time,end_time) \
+  do { if (RogueTimeline_enabled) RogueTimeline_record( 'X', name, category, start_time, (end_time)-(start_time) ); } while (false)
+
+extern volatile bool RogueTimeline_enabled;
+
+void        RogueTimeline_record( char phase, const char* name, const char* category,
+                                  RogueReal64 timestamp, RogueReal64 duration );
+const char* RogueTimeline_intern( RogueString* name );
+const char* RogueTimeline_type_name( RogueObject* obj );
+void        RogueTimeline_set_thread_name( const char* name );
+bool        RogueTimeline_start( int events_per_thread );
+void        RogueTimeline_stop();
+bool        RogueTimeline_save( const char* filepath );
+
+
 //-----------------------------------------------------------------------------
 //  Error Handling
 //-----------------------------------------------------------------------------